@@ -9,8 +9,10 @@ void Chip8::initialize(){
 	opcode   = 0;
 	I	     = 0;
 
-	//std::srand(std::time(nullptr));
-	std::srand(0);
+	// Same generator as std::minstd_rand, whose state must not be 0
+	randomState = randomSeed % 2147483647;
+	if(randomState == 0){ randomState = 1; }
+	faulted = false;
 
 	// Clear display
 	for(auto& c: gfx){
@@ -48,11 +50,19 @@ void Chip8::initialize(){
     sound_timer = 0;
 
     drawFlag = false;
+
+    // Everything was rewritten above, so hash the arrays from scratch once
+    arrayHash = computeArrayHash();
 }
 
 void Chip8::emulateCycle(){
+	// A faulted machine stays stopped until it is initialized again
+	if(faulted){
+		return;
+	}
+
 	// Fetch opcode
-	opcode = (memory[pc] << 8) | (memory[pc+1]);
+	opcode = (memory[pc & 0xFFF] << 8) | (memory[(pc+1) & 0xFFF]);
 
 	// Precalculate opcode bits
 	unsigned short X   = (opcode & 0x0F00) >> 8;
@@ -69,19 +79,26 @@ void Chip8::emulateCycle(){
             {
                 // 0x00E0 : Clears the screen.
                 case 0x0000:
-                    for(auto& p: gfx){ p = 0; }
+                    for(unsigned int i=0; i<64*32; i++){
+                        if(gfx[i] != 0){ writeGfx(i, 0); }
+                    }
+                    drawFlag = true;
                     pc += 2;
                     //op_clearScreen(opcode);
                     break;
 
                 // 0x00EE : Returns from a subroutine
                 case 0x000E:
+                    if(sp == 0){
+                        fault("Stack underflow");
+                        break;
+                    }
                     --sp;
                     pc = stack[sp] + 2;
                     break;
 
                 default:
-                    std::cout <<"Unknown opcode " << opcode << std::endl;
+                    if(!headless){ std::cout <<"Unknown opcode " << opcode << std::endl; }
             }
             break;
 
@@ -92,7 +109,11 @@ void Chip8::emulateCycle(){
 
         // 0x2NNN : Call subroutine at NNN
         case 0x2000:
-            stack[sp] = pc;
+            if(sp >= 16){
+                fault("Stack overflow");
+                break;
+            }
+            writeStack(sp, pc);
             ++sp;
             pc = NNN;
             break;
@@ -117,13 +138,13 @@ void Chip8::emulateCycle(){
 
         // 0x6XNN : Sets VX to NN
         case 0x6000:
-            V[X] = NN;
+            writeV(X, NN);
             pc += 2;
             break;
 
         // 0x7XNN : Adds NN to VX (Carry flag is not changed)
         case 0x7000:
-            V[X] += NN;
+            writeV(X, V[X] + NN);
             pc += 2;
             break;
 
@@ -133,69 +154,76 @@ void Chip8::emulateCycle(){
             {
                 // 0x8XY0 : Sets VX to the value of VY
                 case 0x0000:
-                    V[X] = V[Y];
+                    writeV(X, V[Y]);
                     pc += 2;
                     break;
 
                 // 0x8XY1 : Sets VX to VX or VY (Bitwise OR operation)
                 case 0x0001:
-                    V[X] = V[X] | V[Y];
+                    writeV(X, V[X] | V[Y]);
+                    if(quirks.logicResetsVF){ writeV(0xF, 0); }
                     pc += 2;
                     break;
 
                 // 0x8XY2 : Sets VX to VX and VY (Bitwise AND operation)
                 case 0x0002:
-                    V[X] = V[X] & V[Y];
+                    writeV(X, V[X] & V[Y]);
+                    if(quirks.logicResetsVF){ writeV(0xF, 0); }
                     pc += 2;
                     break;
 
                 // 0x8XY3 : Sets VX to VX xor VY (Bitwise XOR operation)
                 case 0x0003:
-                    V[X] = V[X] ^ V[Y];
+                    writeV(X, V[X] ^ V[Y]);
+                    if(quirks.logicResetsVF){ writeV(0xF, 0); }
                     pc += 2;
                     break;
 
                 // 0x8XY4 : Adds VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't.
                 case 0x0004:
-                    if(V[Y] > (0xFF - V[X])){ V[0xF] = 1; }
-                    else { V[0xF] = 0; }
-                    V[X] += V[Y];
+                    if(V[Y] > (0xFF - V[X])){ writeV(0xF, 1); }
+                    else { writeV(0xF, 0); }
+                    writeV(X, V[X] + V[Y]);
                     pc += 2;
                     break;
 
                 // 0x8XY5 : VY is subtracted from VX.
                 // VF is set to 0 when there's a borrow, and 1 when there isn't.
                 case 0x0005:
-                    if(V[Y] > V[X]){ V[0xF] = 0; }
-                    else{ V[0xF] = 1; }
-                    V[X] = V[X] - V[Y];
+                    if(V[Y] > V[X]){ writeV(0xF, 0); }
+                    else{ writeV(0xF, 1); }
+                    writeV(X, V[X] - V[Y]);
                     pc += 2;
                     break;
 
                 // 0x8XY6 : Stores the least significant bit of VX in VF and then shifts VX to the right by 1
+                // (with the shift quirk, VY is shifted into VX instead)
                 case 0x0006:
-                    V[0xF] = V[X] & 0x1;
-                    V[X] >>= 1;
+                    if(quirks.shiftUsesVY){ writeV(X, V[Y]); }
+                    writeV(0xF, V[X] & 0x1);
+                    writeV(X, V[X] >> 1);
                     pc += 2;
                     break;
 
                 // 0x8XY7 : Sets VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't.
                 case 0x0007:
-                    if(V[X] > V[Y]) { V[0xF] = 0; }
-                    else { V[0xF] = 1; }
-                    V[X] = V[Y] - V[X];
+                    if(V[X] > V[Y]) { writeV(0xF, 0); }
+                    else { writeV(0xF, 1); }
+                    writeV(X, V[Y] - V[X]);
                     pc += 2;
                     break;
 
                 // 0x8XYE : Stores the most significant bit of VX in VF and then shifts VX to the left by 1.
+                // (with the shift quirk, VY is shifted into VX instead)
                 case 0x000E:
-                    V[0xF] = (V[X] & 0x80) >> 7;
-                    V[X] <<= 1;
+                    if(quirks.shiftUsesVY){ writeV(X, V[Y]); }
+                    writeV(0xF, (V[X] & 0x80) >> 7);
+                    writeV(X, V[X] << 1);
                     pc += 2;
                     break;
 
                 default:
-                    std::cout <<"Unknown opcode " << opcode << std::endl;
+                    if(!headless){ std::cout <<"Unknown opcode " << opcode << std::endl; }
             }
             break;
 
@@ -213,14 +241,16 @@ void Chip8::emulateCycle(){
             break;
 
         // 0xBNNN : Jumps to the address NNN plus V0.
+        // (with the jump quirk, BXNN jumps to XNN plus VX)
         case 0xB000:
-            pc = NNN + V[0];
+            pc = NNN + V[quirks.jumpUsesVX ? X : 0];
             break;
 
         // 0xCXNN : Sets VX to the result of a bitwise and operation on a random
         // number (Typically: 0 to 255) and NN.
         case 0xC000:
-            V[X] = std::rand() & NN;
+            randomState = (uint64_t)randomState * 48271 % 2147483647;
+            writeV(X, randomState & NN);
             pc += 2;
             break;
 
@@ -239,18 +269,18 @@ void Chip8::emulateCycle(){
             {
                 // 0xEX9E : Skips the next instruction if the key stored in VX is pressed.
                 case 0x000E:
-                    if(key[V[X]] != 0){ pc += 4; }
+                    if(key[V[X] & 0xF] != 0){ pc += 4; }
                     else { pc += 2; }
                     break;
 
                 // 0xEXA1 : Skips the next instruction if the key stored in VX isn't pressed.
                 case 0x0001:
-                    if(key[V[X]] == 0){ pc += 4; }
+                    if(key[V[X] & 0xF] == 0){ pc += 4; }
                     else { pc += 2; }
                     break;
 
                 default:
-                    std::cout <<"Unknown opcode " << opcode << std::endl;
+                    if(!headless){ std::cout <<"Unknown opcode " << opcode << std::endl; }
             }
             break;
 
@@ -260,7 +290,7 @@ void Chip8::emulateCycle(){
             {
                 // 0xFX07 : Sets VX to the value of the delay timer.
                 case 0x0007:
-                    V[X] = delay_timer;
+                    writeV(X, delay_timer);
                     pc += 2;
                     break;
 
@@ -269,7 +299,7 @@ void Chip8::emulateCycle(){
                 case 0x000A:
                     for(unsigned int i=0; i<16; i++){
                         if(key[i] != 0){
-                            V[X] = i;
+                            writeV(X, i);
                             pc += 2;
                             break;
                         }
@@ -314,7 +344,8 @@ void Chip8::emulateCycle(){
                         // address I. The offset from I is increased by 1 for each value written,
                         // but I itself is left unmodified.
                         case 0x0050:
-                            for(unsigned int i=0; i <= X; i++){ memory[I+i] = V[i]; }
+                            for(unsigned int i=0; i <= X; i++){ writeMemory(I+i, V[i]); }
+                            if(quirks.loadStoreIncrementsI){ I += X + 1; }
                             pc += 2;
                             break;
 
@@ -322,7 +353,8 @@ void Chip8::emulateCycle(){
                         // at address I. The offset from I is increased by 1 for each value
                         // written, but I itself is left unmodified.
                         case 0x0060:
-                            for(unsigned int i=0; i <= X; i++){ V[i] = memory[i+I]; }
+                            for(unsigned int i=0; i <= X; i++){ writeV(i, memory[(i+I) & 0xFFF]); }
+                            if(quirks.loadStoreIncrementsI){ I += X + 1; }
                             pc += 2;
                             break;
                     }
@@ -332,13 +364,17 @@ void Chip8::emulateCycle(){
     }
 
 	// Execute opcode
-	// update timers
+}
+
+// Timers count down at 60Hz, independently of the instruction rate, so this is
+// called once per frame rather than once per cycle.
+void Chip8::tickTimers(){
     if(delay_timer > 0)
         --delay_timer;
 
     if(sound_timer > 0)
     {
-        if(sound_timer == 1)
+        if(sound_timer == 1 && !headless)
             printf("BEEP!\n");
         --sound_timer;
     }
@@ -398,33 +434,49 @@ void Chip8::load(){
     if (result != lSize) {fputs ("Reading error",stderr); exit (3);}
 
     /* the whole file is now loaded in the memory buffer. */
-
-
-    // transfer the contents of buffer to the memory starting
-    // at address 0x200
-    for(int i = 0; i < lSize; ++i)
-    memory[i + 512] = buffer[i];
+    loadFromBuffer((unsigned char*)buffer, lSize);
+    romHash = hashRom((unsigned char*)buffer, lSize);
 
     // terminate
     fclose (pFile);
     free(buffer);
 }
 
+void Chip8::loadFromBuffer(const unsigned char* data, size_t size){
+    if (size > sizeof(memory) - 512) {fputs ("ROM too large",stderr); exit (4);}
+
+    // transfer the contents of buffer to the memory starting
+    // at address 0x200
+    for(size_t i = 0; i < size; ++i)
+    writeMemory(i + 512, data[i]);
+}
+
 void Chip8::op_drawSpriteAtCoordVXVY(unsigned short code){
     unsigned short x = V[(opcode & 0x0F00) >> 8];
     unsigned short y = V[(opcode & 0x00F0) >> 4];
     unsigned short height = opcode & 0x000F;
     unsigned short pixel;
 
-    V[0xF] = 0;
+    // With the clip quirk, the start position wraps around the screen but the
+    // sprite itself is cut at the edges
+    if(quirks.clipSprites){
+        x %= 64;
+        y %= 32;
+    }
+
+    writeV(0xF, 0);
     for (int yline = 0; yline < height; yline++) {
-        pixel = memory[I + yline];
+        pixel = memory[(I + yline) & 0xFFF];
+        if(quirks.clipSprites && y + yline >= 32){ break; }
         for(int xline = 0; xline < 8; xline++) {
+            if(quirks.clipSprites && x + xline >= 64){ break; }
             if((pixel & (0x80 >> xline)) != 0) {
-                if(gfx[(x + xline + ((y + yline) * 64))] == 1){
-                    V[0xF] = 1;
+                // Pixels past the bottom of the screen wrap around to the top
+                unsigned int index = (x + xline + ((y + yline) * 64)) % (64*32);
+                if(gfx[index] == 1){
+                    writeV(0xF, 1);
                 }
-                gfx[x + xline + ((y + yline) * 64)] ^= 1;
+                writeGfx(index, gfx[index] ^ 1);
             }
         }
     }
@@ -436,12 +488,44 @@ void Chip8::op_drawSpriteAtCoordVXVY(unsigned short code){
 void Chip8::op_storeBcdRepOfVxAtI0To2(unsigned short code){
     unsigned short x  = (code & 0x0F00) >> 8;
 
-    memory[I]     =  V[x] / 100;
-    memory[I + 1] = (V[x] / 10 )  % 10;
-    memory[I + 2] = (V[x] % 100) % 10;
+    writeMemory(I,      V[x] / 100);
+    writeMemory(I + 1, (V[x] / 10 )  % 10);
+    writeMemory(I + 2, (V[x] % 100) % 10);
     pc += 2;
 }
 
+// FNV-1a, used to identify a game by its contents
+uint64_t Chip8::hashRom(const unsigned char* data, size_t size){
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for(size_t i = 0; i < size; ++i){
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+uint64_t Chip8::stateHash() const{
+    // The scalar registers change on almost every cycle, so they are folded in
+    // here instead of being tracked on every write. This is still O(1).
+    return arrayHash
+        ^ zobristKey(hash_I,     I)
+        ^ zobristKey(hash_PC,    pc)
+        ^ zobristKey(hash_SP,    sp)
+        ^ zobristKey(hash_Delay, delay_timer)
+        ^ zobristKey(hash_Sound, sound_timer)
+        ^ zobristKey(hash_RandomLo, randomState & 0xFFFF)
+        ^ zobristKey(hash_RandomHi, randomState >> 16);
+}
+
+uint64_t Chip8::computeArrayHash() const{
+    uint64_t hash = 0;
+    for(unsigned int i=0; i<4096; i++){ hash ^= zobristKey(hash_Memory + i, memory[i]); }
+    for(unsigned int i=0; i<64*32; i++){ hash ^= zobristKey(hash_Gfx + i, gfx[i]); }
+    for(unsigned int i=0; i<16; i++){ hash ^= zobristKey(hash_V + i, V[i]); }
+    for(unsigned int i=0; i<16; i++){ hash ^= zobristKey(hash_Stack + i, stack[i]); }
+    return hash;
+}
+
 void Chip8::copyGfxBuffer(unsigned char* targetBuffer){
     for(unsigned int i=0; i<64*32; i++){
         targetBuffer[i] = gfx[i];
@@ -463,6 +547,15 @@ void Chip8::resetGame(){
     load();
 }
 
+void Chip8::fault(const char* reason){
+    faulted = true;
+    if(!headless){ std::cout << reason << " at " << std::hex << pc << std::dec << std::endl; }
+}
+
+void Chip8::setRandomSeed(unsigned int seed){
+    randomSeed = seed;
+}
+
 //
 // EOF
 //
@@ -3,7 +3,22 @@
  * Description: This file contains the header definitions for the chip8 class.
  * */
 
+ #ifndef CHIP8_H
+ #define CHIP8_H
+
  #include <string>
+ #include <cstddef>
+ #include <cstdint>
+
+// Behaviours that differ between CHIP-8 interpreters. The defaults are the
+// behaviour this emulator has always had.
+struct Quirks {
+    bool shiftUsesVY = false;           // 8XY6/8XYE shift VY into VX
+    bool loadStoreIncrementsI = false;  // FX55/FX65 leave I at I + X + 1
+    bool jumpUsesVX = false;            // BNNN jumps to XNN + VX
+    bool logicResetsVF = false;         // 8XY1/8XY2/8XY3 set VF to 0
+    bool clipSprites = false;           // DXYN cuts sprites at the screen edges
+};
 
 class Chip8 {
 public:
@@ -11,12 +26,33 @@ public:
     /* Public interface */
 	void initialize();
 	void emulateCycle();
+	void tickTimers();
 	void printStatus();
 	void load();
+	void loadFromBuffer(const unsigned char* data, size_t size);
 	void copyGfxBuffer(unsigned char* targetBuffer);
 	void copyKeyBuffer(unsigned char* sourceKey);
 	void setGameFileName(char* filename);
 	void resetGame();
+	void setRandomSeed(unsigned int seed);
+	void fault(const char* reason);
+
+	// Hash of the whole machine state (V, I, pc, sp, stack, timers, memory,
+	// gfx and the random generator), available in O(1). Two machines in the same state have the
+	// same hash. See the write helpers below.
+	uint64_t stateHash() const;
+	uint64_t computeArrayHash() const;
+
+	// Hash of a game's contents, used to look it up in the rom database.
+	static uint64_t hashRom(const unsigned char* data, size_t size);
+
+	// Every write to memory, gfx, V or the stack goes through these helpers,
+	// which keep arrayHash up to date (Zobrist hashing: the key of the old
+	// value is xor-ed out and the key of the new one xor-ed in).
+	void writeMemory(unsigned short address, unsigned char value);
+	void writeGfx(unsigned int index, unsigned char value);
+	void writeV(unsigned int x, unsigned char value);
+	void writeStack(unsigned int level, unsigned short value);
 
 	// Special OpCode operations
 	void op_drawSpriteAtCoordVXVY(unsigned short code);
@@ -86,8 +122,80 @@ public:
 
     // The name of a chip8 game
     char* filename;
+
+    // Content hash of the last game read by load(). loadFromBuffer() does not
+    // update it, callers that keep the game in memory hash it once themselves.
+    uint64_t romHash = 0;
+
+    // Interpreter quirks of the loaded game. Kept across resets.
+    Quirks quirks;
+
+    // Zobrist hash of memory, gfx, V and stack, maintained by the write helpers
+    uint64_t arrayHash = 0;
+
+    // State of the random number generator used by CXNN (the same generator as
+    // std::minstd_rand). Every instance owns its own state, so several machines
+    // can run side by side (e.g. on different threads) and still be
+    // reproducible from their seed.
+    uint32_t randomState = 1;
+    unsigned int randomSeed = 0;
+
+    // Set when the program did something the machine cannot do (stack overflow
+    // or underflow). emulateCycle() does nothing until initialize() is called.
+    bool faulted = false;
+
+    // When set, the interpreter does not print to the console (beeps, unknown
+    // opcodes). Used when running many machines without a window.
+    bool headless = false;
 };
 
+// Locations used by the state hash. Each value stored at a location has its
+// own pseudo random key, computed on the fly instead of read from a table.
+enum HashLocation : uint32_t {
+    hash_Memory = 0x0000,   // 4096 locations
+    hash_Gfx    = 0x1000,   // 2048 locations
+    hash_V      = 0x1800,   // 16 locations
+    hash_Stack  = 0x1810,   // 16 locations
+    hash_I      = 0x1820,
+    hash_PC     = 0x1821,
+    hash_SP     = 0x1822,
+    hash_Delay  = 0x1823,
+    hash_Sound  = 0x1824,
+    hash_RandomLo = 0x1825,
+    hash_RandomHi = 0x1826
+};
+
+// splitmix64 finalizer of (location, value)
+inline uint64_t zobristKey(uint32_t location, uint16_t value){
+    uint64_t z = ((uint64_t)location << 16 | value) + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+inline void Chip8::writeMemory(unsigned short address, unsigned char value){
+    address &= 0xFFF;
+    arrayHash ^= zobristKey(hash_Memory + address, memory[address]) ^ zobristKey(hash_Memory + address, value);
+    memory[address] = value;
+}
+
+inline void Chip8::writeGfx(unsigned int index, unsigned char value){
+    arrayHash ^= zobristKey(hash_Gfx + index, gfx[index]) ^ zobristKey(hash_Gfx + index, value);
+    gfx[index] = value;
+}
+
+inline void Chip8::writeV(unsigned int x, unsigned char value){
+    arrayHash ^= zobristKey(hash_V + x, V[x]) ^ zobristKey(hash_V + x, value);
+    V[x] = value;
+}
+
+inline void Chip8::writeStack(unsigned int level, unsigned short value){
+    arrayHash ^= zobristKey(hash_Stack + level, stack[level]) ^ zobristKey(hash_Stack + level, value);
+    stack[level] = value;
+}
+
+#endif // CHIP8_H
+
 //
 // EOF
 //
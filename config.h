@@ -1,9 +1,17 @@
 // config.h - Software configurations.
 
-// Changing this value will increase the number of screen pixels per chip8 display pixel.
-// Increasing the size makes the game potentially slower due to the drawing overhead.
+// Initial number of screen pixels per chip8 display pixel. The window can be resized
+// at runtime (or started with --scale N); scaling is done by the GPU.
 constexpr unsigned int config_DotSize = 4;
 
+// Fraction of a pixel's brightness that remains after 1/60 s when phosphor persistence
+// is enabled (P key, or --phosphor D). Higher values hide more sprite flicker.
+constexpr float config_PhosphorDecay = 0.6f;
+
+// Database of per-game settings (quirks, speed, key layout), read once at startup.
+// See romdb.h for the file format.
+constexpr const char* config_RomDatabase = "roms.db";
+
 //
 // EOF
 //
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include "display.h"
+
+// Keeps the brighter of the new frame and the decayed previous result.
+// Render textures are stored bottom-up, so the previous result is sampled
+// with a flipped y coordinate.
+static const char* phosphorShaderSource =
+    "uniform sampler2D frame;\n"
+    "uniform sampler2D previous;\n"
+    "uniform float decay;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 uv = gl_TexCoord[0].xy;\n"
+    "    vec4 lit = texture2D(frame, uv);\n"
+    "    vec4 old = texture2D(previous, vec2(uv.x, 1.0 - uv.y)) * decay;\n"
+    "    gl_FragColor = vec4(max(lit.rgb, old.rgb), 1.0);\n"
+    "}\n";
+
+void Display::initialize(float l_phosphorDecay){
+    // Start with a black, opaque frame
+    for(unsigned int i=0; i<64*32; i++){
+        pixels[4*i]   = 0x00;
+        pixels[4*i+1] = 0x00;
+        pixels[4*i+2] = 0x00;
+        pixels[4*i+3] = 0xFF;
+    }
+
+    frameTexture.create(64, 32);
+    frameTexture.setSmooth(false);
+    frameTexture.update(pixels);
+
+    // The phosphor pass needs shaders and render textures. Without them the
+    // frames are presented as they are.
+    phosphorAvailable = sf::Shader::isAvailable()
+        && phosphorShader.loadFromMemory(phosphorShaderSource, sf::Shader::Fragment);
+    for(auto& buffer: persistence){
+        if(!phosphorAvailable || !buffer.create(64, 32)){
+            phosphorAvailable = false;
+            break;
+        }
+        buffer.setSmooth(false);
+        buffer.clear(sf::Color::Black);
+        buffer.display();
+    }
+
+    current = 0;
+    phosphorDecay = 0;
+    setPhosphorDecay(l_phosphorDecay);
+}
+
+void Display::update(const unsigned char* gfx){
+    for(unsigned int i=0; i<64*32; i++){
+        sf::Uint8 level = gfx[i] ? 0xFF : 0x00;
+        pixels[4*i]   = level;
+        pixels[4*i+1] = level;
+        pixels[4*i+2] = level;
+    }
+    frameTexture.update(pixels);
+}
+
+void Display::draw(sf::RenderWindow& window){
+    const sf::Texture* texture = &frameTexture;
+    if(phosphorAvailable && phosphorDecay > 0){
+        blendPhosphor();
+        texture = &persistence[current].getTexture();
+    }
+
+    // Largest 2:1 rectangle that fits in the window, centered
+    sf::Vector2u size = window.getSize();
+    float scale = std::min(size.x / 64.f, size.y / 32.f);
+
+    sf::Sprite sprite(*texture);
+    sprite.setScale(scale, scale);
+    sprite.setPosition(std::floor((size.x - 64*scale) / 2), std::floor((size.y - 32*scale) / 2));
+    window.draw(sprite);
+}
+
+void Display::blendPhosphor(){
+    // The decay is given per 1/60 s, scale it to the time since the last blend
+    float elapsed = phosphorClock.restart().asSeconds();
+    float decay = std::pow(phosphorDecay, elapsed * 60.f);
+
+    unsigned int next = 1 - current;
+    phosphorShader.setUniform("frame", sf::Shader::CurrentTexture);
+    phosphorShader.setUniform("previous", persistence[current].getTexture());
+    phosphorShader.setUniform("decay", decay);
+
+    persistence[next].clear(sf::Color::Black);
+    persistence[next].draw(sf::Sprite(frameTexture), sf::RenderStates(&phosphorShader));
+    persistence[next].display();
+    current = next;
+}
+
+void Display::setPhosphorDecay(float decay){
+    if(decay < 0){ decay = 0; }
+    if(decay > 1){ decay = 1; }
+
+    if(decay > 0 && !phosphorAvailable){
+        std::cout << "Phosphor persistence is not available on this system." << std::endl;
+    }
+
+    // Start from black when switched on, rather than from the frame that was
+    // shown when it was switched off
+    if(decay > 0 && phosphorDecay == 0 && phosphorAvailable){
+        for(auto& buffer: persistence){
+            buffer.clear(sf::Color::Black);
+            buffer.display();
+        }
+    }
+    phosphorDecay = decay;
+    phosphorClock.restart();
+}
+
+float Display::getPhosphorDecay() const{
+    return phosphorDecay;
+}
+
+//
+// EOF
+//
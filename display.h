@@ -0,0 +1,54 @@
+/*
+ * File: display.h
+ * Description: GPU presentation of the chip8 screen.
+ *
+ * The 64x32 gfx buffer is uploaded as a tiny texture and scaled by the GPU,
+ * so the CPU cost does not depend on the window size. An optional phosphor
+ * persistence pass blends each frame with the decayed previous one, which
+ * hides the flicker of XOR drawn sprites.
+ * */
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <SFML/Graphics.hpp>
+
+class Display {
+public:
+    // Must be called once, before any other member function.
+    void initialize(float phosphorDecay);
+
+    // Uploads a new chip8 frame (64*32 bytes, one per pixel).
+    void update(const unsigned char* gfx);
+
+    // Draws the current frame into the window, as large as possible while
+    // keeping the 2:1 aspect ratio, with nearest neighbour sampling.
+    void draw(sf::RenderWindow& window);
+
+    // Fraction of a pixel's brightness that remains after 1/60 of a second.
+    // 0 disables the phosphor persistence.
+    void setPhosphorDecay(float decay);
+    float getPhosphorDecay() const;
+
+private:
+    void blendPhosphor();
+
+    // RGBA copy of the last uploaded frame
+    sf::Uint8 pixels[64*32*4];
+    sf::Texture frameTexture;
+
+    // Phosphor persistence: the blend of the current frame and the previous
+    // result is rendered into the other buffer, then the two are swapped.
+    sf::RenderTexture persistence[2];
+    unsigned int current;
+    sf::Shader phosphorShader;
+    bool phosphorAvailable;
+    float phosphorDecay;
+    sf::Clock phosphorClock;
+};
+
+#endif // DISPLAY_H
+
+//
+// EOF
+//
@@ -0,0 +1,119 @@
+//
+// This is the main file for the headless, batched chip8 environment server.
+//
+// Usage:
+//   chip8env <game> <numEnvs> [--threads N] [--cycles N] [--shm NAME]
+//            [--socket PATH] [--reward ADDR]... [--done ADDR=VALUE] [--db PATH]
+//            [--revisits [LIMIT]]
+//
+// Quirks and cycles per frame are taken from the rom database when the game
+// is listed there; --cycles overrides the database.
+//
+// Addresses and values accept decimal or 0x-prefixed hexadecimal numbers.
+//
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cstdlib>
+#include <cstring>
+#include "envserver.h"
+#include "romdb.h"
+#include "config.h"
+
+void printUsage(){
+    std::cout << "Usage: chip8env <game> <numEnvs> [--threads N] [--cycles N] [--shm NAME]" << std::endl
+              << "                [--socket PATH] [--reward ADDR]... [--done ADDR=VALUE] [--db PATH]" << std::endl
+              << "                [--revisits [LIMIT]]" << std::endl;
+}
+
+int main(int argc, char** argv){
+
+    if(argc < 3){
+        printUsage();
+        return 1;
+    }
+
+    EnvConfig config;
+    config.numEnvs = std::strtoul(argv[2], nullptr, 0);
+    if(config.numEnvs == 0){
+        std::cout << "Error. The number of environments must be at least 1." << std::endl;
+        return 1;
+    }
+
+    const char* databasePath = config_RomDatabase;
+    bool hasCycles = false;
+
+    for(int i=3; i<argc; i++){
+        bool hasValue = i + 1 < argc;
+        if(std::strcmp(argv[i], "--threads") == 0 && hasValue){
+            config.numThreads = std::strtoul(argv[++i], nullptr, 0);
+        }
+        else if(std::strcmp(argv[i], "--cycles") == 0 && hasValue){
+            config.cyclesPerFrame = std::strtoul(argv[++i], nullptr, 0);
+            hasCycles = true;
+        }
+        else if(std::strcmp(argv[i], "--shm") == 0 && hasValue){
+            config.shmName = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--socket") == 0 && hasValue){
+            config.socketPath = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--reward") == 0 && hasValue){
+            config.rewardAddresses.push_back(std::strtoul(argv[++i], nullptr, 0) & 0xFFF);
+        }
+        else if(std::strcmp(argv[i], "--revisits") == 0){
+            config.trackRevisits = true;
+            if(hasValue && argv[i+1][0] >= '0' && argv[i+1][0] <= '9'){
+                config.revisitLimit = std::strtoul(argv[++i], nullptr, 0);
+            }
+        }
+        else if(std::strcmp(argv[i], "--db") == 0 && hasValue){
+            databasePath = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--done") == 0 && hasValue){
+            char* value;
+            config.hasDoneCondition = true;
+            config.doneAddress = std::strtoul(argv[++i], &value, 0) & 0xFFF;
+            if(*value == '='){ value++; }
+            config.doneValue = std::strtoul(value, nullptr, 0);
+        }
+        else{
+            printUsage();
+            return 1;
+        }
+    }
+
+    // Read the game once; every reset copies it from memory
+    std::ifstream file(argv[1], std::ios::binary);
+    if(!file){
+        std::cout << "Error. Could not open " << argv[1] << std::endl;
+        return 1;
+    }
+    std::vector<unsigned char> rom((std::istreambuf_iterator<char>(file)),
+                                    std::istreambuf_iterator<char>());
+
+    // Pick the settings of this game from the rom database, if it is there
+    RomDatabase romDatabase;
+    romDatabase.loadWithFallback(databasePath, argv[0]);
+    const RomProfile* profile = romDatabase.find(Chip8::hashRom(rom.data(), rom.size()));
+    if(profile){
+        std::cout << "Game profile: " << profile->title << " (" << platformName(profile->platform) << ")" << std::endl;
+        if(profile->platform != platform_Chip8){
+            std::cout << "Warning: only CHIP-8 instructions are supported." << std::endl;
+        }
+        config.quirks = profile->quirks;
+        if(!hasCycles && profile->cyclesPerFrame > 0){
+            config.cyclesPerFrame = profile->cyclesPerFrame;
+        }
+    }
+
+    EnvServer server(config, rom);
+    server.run();
+
+    return 0;
+}
+
+//
+// EOF
+//
@@ -0,0 +1,267 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "envserver.h"
+
+EnvServer::EnvServer(const EnvConfig& l_config, const std::vector<unsigned char>& l_rom)
+    : config(l_config), rom(l_rom), envs(l_config.numEnvs),
+      numWorkers(0), generation(0), pendingWorkers(0), pendingFrames(0), stopping(false)
+{
+    // Setup the shared memory region
+    shmSize = sizeof(EnvSharedHeader) + config.numEnvs * sizeof(EnvSlot);
+    shm_unlink(config.shmName);
+    shmFd = shm_open(config.shmName, O_CREAT | O_RDWR, 0600);
+    if (shmFd < 0) {perror ("shm_open"); exit (1);}
+    if (ftruncate(shmFd, shmSize) != 0) {perror ("ftruncate"); exit (1);}
+
+    void* region = mmap(nullptr, shmSize, PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+    if (region == MAP_FAILED) {perror ("mmap"); exit (1);}
+    std::memset(region, 0, shmSize);
+
+    header = (EnvSharedHeader*) region;
+    slots  = (EnvSlot*) ((char*) region + sizeof(EnvSharedHeader));
+    header->magic    = env_Magic;
+    header->version  = env_Version;
+    header->numEnvs  = config.numEnvs;
+    header->slotSize = sizeof(EnvSlot);
+
+    // Setup the control socket
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {perror ("socket"); exit (1);}
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, config.socketPath, sizeof(addr.sun_path) - 1);
+    unlink(config.socketPath);
+    if (bind(listenFd, (sockaddr*) &addr, sizeof(addr)) != 0) {perror ("bind"); exit (1);}
+    if (listen(listenFd, 1) != 0) {perror ("listen"); exit (1);}
+
+    // Setup the machines
+    if(config.trackRevisits){
+        visited.assign(config.numEnvs, StateCache(1024, config.revisitLimit));
+    }
+    for(unsigned int i=0; i<config.numEnvs; i++){
+        envs[i].headless = true;
+        envs[i].quirks = config.quirks;
+        resetEnv(i, 0);
+    }
+
+    // Start the workers
+    numWorkers = config.numThreads;
+    if(numWorkers == 0){
+        numWorkers = std::thread::hardware_concurrency();
+    }
+    if(numWorkers == 0){ numWorkers = 1; }
+    if(numWorkers > config.numEnvs){ numWorkers = config.numEnvs; }
+
+    for(unsigned int w=0; w<numWorkers; w++){
+        workers.emplace_back(&EnvServer::workerLoop, this, w);
+    }
+}
+
+EnvServer::~EnvServer(){
+    {
+        std::lock_guard<std::mutex> lock(workMutex);
+        stopping = true;
+    }
+    workStart.notify_all();
+    for(auto& t: workers){
+        t.join();
+    }
+
+    close(listenFd);
+    unlink(config.socketPath);
+
+    munmap(header, shmSize);
+    close(shmFd);
+    shm_unlink(config.shmName);
+}
+
+void EnvServer::run(){
+    std::cout << "------- Serving " << config.numEnvs << " environments on "
+              << config.socketPath << " (shm " << config.shmName << ") -------" << std::endl;
+
+    bool closeRequested = false;
+    while(!closeRequested){
+        int client = accept(listenFd, nullptr, nullptr);
+        if(client < 0){
+            perror("accept");
+            continue;
+        }
+        closeRequested = serveClient(client);
+        close(client);
+    }
+}
+
+// Reads commands from one driver until it disconnects. Returns true if the
+// driver asked the server to shut down.
+bool EnvServer::serveClient(int client){
+    EnvCommand cmd;
+    while(recv(client, &cmd, sizeof(cmd), MSG_WAITALL) == sizeof(cmd)){
+        EnvReply reply{};
+
+        switch(cmd.type){
+            case ENV_RESET:
+                if(cmd.env != env_AllEnvs && cmd.env >= config.numEnvs){
+                    reply.status = 1;
+                    break;
+                }
+                reset(cmd.env, cmd.seed);
+                break;
+
+            case ENV_STEP:
+                step(cmd.framesPerStep);
+                break;
+
+            case ENV_CLOSE:
+                send(client, &reply, sizeof(reply), MSG_NOSIGNAL);
+                return true;
+
+            default:
+                reply.status = 2;
+        }
+
+        reply.numDone = countDone();
+        if(send(client, &reply, sizeof(reply), MSG_NOSIGNAL) != sizeof(reply)){
+            break;
+        }
+    }
+    return false;
+}
+
+void EnvServer::reset(uint32_t env, uint32_t seed){
+    if(env == env_AllEnvs){
+        for(unsigned int i=0; i<config.numEnvs; i++){
+            resetEnv(i, seed + i);
+        }
+    }
+    else{
+        resetEnv(env, seed + env);
+    }
+}
+
+void EnvServer::resetEnv(unsigned int i, uint32_t seed){
+    Chip8& chip8 = envs[i];
+    chip8.setRandomSeed(seed);
+    chip8.initialize();
+    chip8.loadFromBuffer(rom.data(), rom.size());
+
+    EnvSlot& slot = slots[i];
+    slot.action = 0;
+    slot.done   = 0;
+    slot.reward = 0;
+    slot.revisited = 0;
+    slot.stateHash = chip8.stateHash();
+    chip8.copyGfxBuffer(slot.gfx);
+
+    if(config.trackRevisits){
+        visited[i].clear();
+        visited[i].insert(slot.stateHash);
+    }
+}
+
+void EnvServer::step(uint32_t framesPerStep){
+    std::unique_lock<std::mutex> lock(workMutex);
+    pendingFrames  = framesPerStep;
+    pendingWorkers = numWorkers;
+    ++generation;
+    workStart.notify_all();
+    workDone.wait(lock, [this]{ return pendingWorkers == 0; });
+    ++header->stepCount;
+}
+
+void EnvServer::workerLoop(unsigned int worker){
+    // Contiguous block of machines owned by this worker
+    unsigned int first = worker * config.numEnvs / numWorkers;
+    unsigned int last  = (worker + 1) * config.numEnvs / numWorkers;
+    uint64_t seenGeneration = 0;
+
+    while(true){
+        uint32_t frames;
+        {
+            std::unique_lock<std::mutex> lock(workMutex);
+            workStart.wait(lock, [&]{ return stopping || generation != seenGeneration; });
+            if(stopping){ return; }
+            seenGeneration = generation;
+            frames = pendingFrames;
+        }
+
+        stepRange(first, last, frames);
+
+        {
+            std::lock_guard<std::mutex> lock(workMutex);
+            if(--pendingWorkers == 0){
+                workDone.notify_one();
+            }
+        }
+    }
+}
+
+void EnvServer::stepRange(unsigned int first, unsigned int last, uint32_t framesPerStep){
+    for(unsigned int i=first; i<last; i++){
+        Chip8& chip8 = envs[i];
+        EnvSlot& slot = slots[i];
+
+        slot.reward = 0;
+        if(slot.done){
+            continue;
+        }
+
+        // Apply the action to the keypad
+        unsigned char keys[16];
+        for(unsigned int k=0; k<16; k++){
+            keys[k] = (slot.action >> k) & 0x1;
+        }
+        chip8.copyKeyBuffer(keys);
+
+        int rewardBefore = 0;
+        for(auto a: config.rewardAddresses){ rewardBefore += chip8.memory[a]; }
+
+        bool done = false;
+        for(uint32_t f=0; f<framesPerStep && !done; f++){
+            for(unsigned int c=0; c<config.cyclesPerFrame; c++){
+                chip8.emulateCycle();
+            }
+            chip8.tickTimers();
+
+            // A jump to itself (1NNN with NNN == pc) is how CHIP-8 programs halt
+            unsigned short op = (chip8.memory[chip8.pc & 0xFFF] << 8) | chip8.memory[(chip8.pc + 1) & 0xFFF];
+            done = (op & 0xF000) == 0x1000 && (op & 0x0FFF) == chip8.pc;
+            if(chip8.faulted){
+                done = true;
+            }
+            if(config.hasDoneCondition && chip8.memory[config.doneAddress] == config.doneValue){
+                done = true;
+            }
+        }
+
+        int rewardAfter = 0;
+        for(auto a: config.rewardAddresses){ rewardAfter += chip8.memory[a]; }
+
+        slot.reward = rewardAfter - rewardBefore;
+        slot.done   = done ? 1 : 0;
+        slot.stateHash = chip8.stateHash();
+        if(config.trackRevisits){
+            slot.revisited = visited[i].insert(slot.stateHash) ? 0 : 1;
+        }
+        chip8.copyGfxBuffer(slot.gfx);
+    }
+}
+
+unsigned int EnvServer::countDone() const{
+    unsigned int numDone = 0;
+    for(unsigned int i=0; i<config.numEnvs; i++){
+        numDone += slots[i].done;
+    }
+    return numDone;
+}
+
+//
+// EOF
+//
@@ -0,0 +1,148 @@
+/*
+ * File: envserver.h
+ * Description: Batched, headless environment server around the Chip8 class.
+ *
+ * A batch of N machines is stepped in lockstep. Actions, observations,
+ * rewards and done flags live in a POSIX shared memory region, so a driver
+ * process (e.g. a reinforcement learning trainer) can read and write them
+ * directly. A Unix domain socket only carries small fixed-size control
+ * messages (reset, step, close).
+ * */
+
+#ifndef ENVSERVER_H
+#define ENVSERVER_H
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "chip8.h"
+#include "statecache.h"
+
+// "C8EV", first word of the shared memory region
+constexpr uint32_t env_Magic   = 0x43384556;
+constexpr uint32_t env_Version = 2;
+
+// Used as EnvCommand::env to address every machine in the batch.
+constexpr uint32_t env_AllEnvs = 0xFFFFFFFF;
+
+// Layout of the shared memory region:
+//   EnvSharedHeader, followed by numEnvs consecutive EnvSlot structures.
+struct EnvSharedHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numEnvs;
+    uint32_t slotSize;      // sizeof(EnvSlot), lets drivers check the layout
+    uint64_t stepCount;     // number of completed steps since start
+};
+
+struct EnvSlot {
+    // Written by the driver before a step: bit k set means key k is pressed.
+    uint16_t action;
+    // Set when the machine halted, faulted (stack overflow or underflow) or
+    // the done condition was met. A done machine is not stepped again until
+    // it is reset.
+    uint8_t  done;
+    // Set when the state after the last step (including the random generator,
+    // but not the keypad) was already visited since the last reset. Unless the
+    // driver changes its actions, the machine is looping.
+    uint8_t  revisited;
+    // Sum of the changes of the reward addresses during the last step.
+    int32_t  reward;
+    // Chip8::stateHash() after the last step
+    uint64_t stateHash;
+    // Copy of the gfx buffer after the last step (one byte per pixel, 0 or 1)
+    uint8_t  gfx[64*32];
+};
+
+enum EnvCommandType : uint32_t {
+    ENV_RESET = 1,
+    ENV_STEP  = 2,
+    ENV_CLOSE = 3
+};
+
+// Control message sent by the driver over the socket.
+struct EnvCommand {
+    uint32_t type;          // one of EnvCommandType
+    uint32_t env;           // ENV_RESET: machine index or env_AllEnvs
+    uint32_t seed;          // ENV_RESET: machine i is seeded with seed + i
+    uint32_t framesPerStep; // ENV_STEP: frames to run before returning
+};
+
+// Reply sent back once the command has completed and the shared memory has
+// been updated. status is 0 on success.
+struct EnvReply {
+    uint32_t status;
+    uint32_t numDone;
+};
+
+struct EnvConfig {
+    const char* shmName     = "/chip8env";
+    const char* socketPath  = "/tmp/chip8env.sock";
+    unsigned int numEnvs    = 1;
+    unsigned int numThreads = 0;        // 0 = one per hardware thread
+    unsigned int cyclesPerFrame = 16;   // emulated cycles in one frame
+    Quirks quirks;                      // applied to every machine
+    std::vector<unsigned short> rewardAddresses;
+    // Optional done condition: memory[doneAddress] == doneValue
+    bool hasDoneCondition = false;
+    unsigned short doneAddress = 0;
+    unsigned char doneValue = 0;
+    // Optional loop detection: remember the states of each machine since its
+    // reset (at most revisitLimit of them) and set EnvSlot::revisited.
+    bool trackRevisits = false;
+    size_t revisitLimit = 65536;
+};
+
+class EnvServer {
+public:
+    EnvServer(const EnvConfig& config, const std::vector<unsigned char>& rom);
+    ~EnvServer();
+
+    // Accepts driver connections and serves their commands until a driver
+    // sends ENV_CLOSE.
+    void run();
+
+    // Both of these update the shared memory region before returning.
+    void reset(uint32_t env, uint32_t seed);
+    void step(uint32_t framesPerStep);
+
+private:
+    void resetEnv(unsigned int i, uint32_t seed);
+    void stepRange(unsigned int first, unsigned int last, uint32_t framesPerStep);
+    void workerLoop(unsigned int worker);
+    bool serveClient(int client);
+    unsigned int countDone() const;
+
+    EnvConfig config;
+    std::vector<unsigned char> rom;
+    std::vector<Chip8> envs;
+    std::vector<StateCache> visited;    // states seen by each machine since its reset (trackRevisits)
+
+    // Shared memory
+    int shmFd;
+    size_t shmSize;
+    EnvSharedHeader* header;
+    EnvSlot* slots;
+
+    int listenFd;
+
+    // Worker threads. Machine i is always stepped by the same worker; the
+    // main thread wakes all workers for a step and waits until they finish.
+    std::vector<std::thread> workers;
+    unsigned int numWorkers;
+    std::mutex workMutex;
+    std::condition_variable workStart;
+    std::condition_variable workDone;
+    uint64_t generation;
+    unsigned int pendingWorkers;
+    uint32_t pendingFrames;
+    bool stopping;
+};
+
+#endif // ENVSERVER_H
+
+//
+// EOF
+//
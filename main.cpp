@@ -5,20 +5,37 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/System.hpp>
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 #include "chip8.h"
+#include "display.h"
+#include "romdb.h"
 #include "config.h"
 
-void captureInputs(sf::RenderWindow& window, Chip8& myChip8, unsigned char* keys){
+// Emulation speed is the amount of instructions executed per second. It is
+// never lower than 60, one instruction per frame.
+static unsigned int emulationSpeed = 1000;
 
-    // Emulation speed is (roughly) the amount of instructions executed per second
-    static unsigned int emulationSpeed = 1000;
+// Keyboard key of each chip8 key
+static sf::Keyboard::Key keyMap[16];
 
-    unsigned char A = 0xA;
-    unsigned char B = 0xB;
-    unsigned char C = 0xC;
-    unsigned char D = 0xD;
-    unsigned char E = 0xE;
-    unsigned char F = 0xF;
+// Sets the keyboard layout from 16 characters (0-9, a-z), see romdb.h
+void setKeyMap(const std::string& layout){
+    for(unsigned int k=0; k<16; k++){
+        char c = layout[k];
+        if(c >= '0' && c <= '9'){
+            keyMap[k] = (sf::Keyboard::Key)(sf::Keyboard::Num0 + (c - '0'));
+        }
+        else{
+            keyMap[k] = (sf::Keyboard::Key)(sf::Keyboard::A + (c - 'a'));
+        }
+    }
+}
+
+void captureInputs(sf::RenderWindow& window, Chip8& myChip8, Display& display, unsigned char* keys){
+
+    // Decay used when phosphor persistence is toggled back on
+    static float phosphorDecay = config_PhosphorDecay;
 
     using sf::Keyboard;
 
@@ -30,17 +47,21 @@ void captureInputs(sf::RenderWindow& window, Chip8& myChip8, unsigned char* keys
             window.close();
         }
 
+        // Keep a 1:1 mapping between view and window pixels, the display
+        // does the scaling itself
+        if (event.type == sf::Event::Resized){
+            window.setView(sf::View(sf::FloatRect(0, 0, event.size.width, event.size.height)));
+        }
+
         // Left and Right arrows to decrease or increase emulation speed
         if (event.type == sf::Event::KeyPressed){
             if (Keyboard::isKeyPressed(Keyboard::Right)){
                 emulationSpeed += 50;
                 std::cout << "Set emulation speed to " << emulationSpeed << std::endl;
-                window.setFramerateLimit(emulationSpeed);
             }
             if (Keyboard::isKeyPressed(Keyboard::Left)){
-                emulationSpeed -= 50;
+                emulationSpeed = emulationSpeed >= 110 ? emulationSpeed - 50 : 60;
                 std::cout << "Set emulation speed to " << emulationSpeed << std::endl;
-                window.setFramerateLimit(emulationSpeed);
             }
         }
 
@@ -51,70 +72,24 @@ void captureInputs(sf::RenderWindow& window, Chip8& myChip8, unsigned char* keys
             }
         }
 
-        // Inputs for the Chip8
-        keys[1] = Keyboard::isKeyPressed(Keyboard::Num1) ? 1 : 0;
-        keys[2] = Keyboard::isKeyPressed(Keyboard::Num1) ? 1 : 0;
-        keys[3] = Keyboard::isKeyPressed(Keyboard::Num1) ? 1 : 0;
-        keys[C] = Keyboard::isKeyPressed(Keyboard::Num4) ? 1 : 0;
-        keys[4] = Keyboard::isKeyPressed(Keyboard::Q)    ? 1 : 0;
-        keys[5] = Keyboard::isKeyPressed(Keyboard::W)    ? 1 : 0;
-        keys[6] = Keyboard::isKeyPressed(Keyboard::E)    ? 1 : 0;
-        keys[D] = Keyboard::isKeyPressed(Keyboard::R)    ? 1 : 0;
-        keys[7] = Keyboard::isKeyPressed(Keyboard::A)    ? 1 : 0;
-        keys[8] = Keyboard::isKeyPressed(Keyboard::S)    ? 1 : 0;
-        keys[9] = Keyboard::isKeyPressed(Keyboard::D)    ? 1 : 0;
-        keys[E] = Keyboard::isKeyPressed(Keyboard::F)    ? 1 : 0;
-        keys[A] = Keyboard::isKeyPressed(Keyboard::Z)    ? 1 : 0;
-        keys[0] = Keyboard::isKeyPressed(Keyboard::X)    ? 1 : 0;
-        keys[B] = Keyboard::isKeyPressed(Keyboard::C)    ? 1 : 0;
-        keys[F] = Keyboard::isKeyPressed(Keyboard::V)    ? 1 : 0;
-    }
-
-    myChip8.copyKeyBuffer(keys);
-}
-
-void drawGraphics(Chip8& myChip8, sf::RenderWindow& window){
-    // Create a 64x32 image filled with black color
-    sf::Image image;
-    image.create(64*config_DotSize, 64*config_DotSize, sf::Color::Black);
-
-    unsigned char gfx_bfr[64*32];
-    myChip8.copyGfxBuffer(gfx_bfr);
-
-    // Draw the Chip8 pixels from the gfx buffer into the window screen
-    for(int i=0; i<64; i++){
-        for(int j=0; j<32; j++){
-            bool thisPixel = gfx_bfr[i+j*64];
-            sf::Color thisColor;
-
-            // retrieve the current pixel color
-            if(thisPixel){
-                thisColor = sf::Color::White;
+        // P to toggle phosphor persistence
+        if (event.type == sf::Event::KeyPressed && event.key.code == Keyboard::P){
+            if(display.getPhosphorDecay() > 0){
+                phosphorDecay = display.getPhosphorDecay();
+                display.setPhosphorDecay(0);
             }
             else{
-                thisColor = sf::Color::Black;
-            }
-
-            // Draw the corresponding pixel
-            for(int ii=0; ii<config_DotSize; ii++){
-            for(int jj=0; jj<config_DotSize; jj++){
-                image.setPixel(config_DotSize*i+ii, config_DotSize*j+jj, thisColor);
-            }
+                display.setPhosphorDecay(phosphorDecay);
             }
+        }
 
+        // Inputs for the Chip8
+        for(unsigned int k=0; k<16; k++){
+            keys[k] = Keyboard::isKeyPressed(keyMap[k]) ? 1 : 0;
         }
     }
 
-    // load image to texture
-    sf::Texture texture;
-    texture.loadFromImage(image);
-    sf::Sprite sprite;
-    sprite.setPosition(0, 0);
-    sprite.setTexture(texture, false);
-
-    // draw image in window
-    window.draw(sprite);
-
+    myChip8.copyKeyBuffer(keys);
 }
 
 int main(int argc, char** argv){
@@ -123,11 +98,24 @@ int main(int argc, char** argv){
     unsigned char keys[16]{};
 
 
-    if(argc != 2){
+    if(argc < 2){
         std::cout << "Error. Please provide a game name." << std::endl;
         //return 0;
     }
 
+    // Optional arguments: --scale N (initial window scale), --phosphor D (decay, 0 = off)
+    unsigned int dotSize = config_DotSize;
+    float phosphorDecay = 0;
+    for(int i=2; i+1<argc; i+=2){
+        if(std::strcmp(argv[i], "--scale") == 0){
+            dotSize = std::strtoul(argv[i+1], nullptr, 0);
+            if(dotSize == 0){ dotSize = 1; }
+        }
+        else if(std::strcmp(argv[i], "--phosphor") == 0){
+            phosphorDecay = std::strtof(argv[i+1], nullptr);
+        }
+    }
+
     // Setup chip8
 	Chip8 myChip8;
 	myChip8.initialize();
@@ -135,27 +123,64 @@ int main(int argc, char** argv){
 	myChip8.setGameFileName(fileName);
 	myChip8.load();
 
+    // Pick the settings of this game from the rom database, if it is there
+    RomDatabase romDatabase;
+    romDatabase.loadWithFallback(config_RomDatabase, argv[0]);
+    setKeyMap(romdb_DefaultKeyMap);
+
+    const RomProfile* profile = romDatabase.find(myChip8.romHash);
+    if(profile){
+        std::cout << "Game profile: " << profile->title << " (" << platformName(profile->platform) << ")" << std::endl;
+        if(profile->platform != platform_Chip8){
+            std::cout << "Warning: only CHIP-8 instructions are supported." << std::endl;
+        }
+        myChip8.quirks = profile->quirks;
+        if(profile->cyclesPerFrame > 0){
+            emulationSpeed = profile->cyclesPerFrame * 60;
+        }
+        setKeyMap(profile->keyMap);
+    }
+    else{
+        std::cout << "No profile for rom hash " << std::hex << myChip8.romHash << std::dec << ", using defaults." << std::endl;
+    }
+
 	// Setup graphics
     sf::ContextSettings settings;
     settings.antialiasingLevel = 8;
-    sf::RenderWindow window(sf::VideoMode(64*config_DotSize, 32*config_DotSize), "Chip-8 Emulator", sf::Style::Default, settings);
-    window.setFramerateLimit(1000);
+    sf::RenderWindow window(sf::VideoMode(64*dotSize, 32*dotSize), "Chip-8 Emulator", sf::Style::Default, settings);
+    // The window is presented at 60Hz, independently of the emulation speed
+    window.setFramerateLimit(60);
+
+    Display display;
+    display.initialize(phosphorDecay);
 
-    // Emulation loop
+    // Instructions owed from previous frames (in 1/60 units), so speeds that
+    // are not a multiple of 60 still run at the right rate on average
+    unsigned int cycleBudget = 0;
+
+    // Emulation loop, one iteration per frame
 	while (window.isOpen())
     {
-		myChip8.emulateCycle();
+        for(cycleBudget += emulationSpeed; cycleBudget >= 60; cycleBudget -= 60){
+            myChip8.emulateCycle();
+        }
+        myChip8.tickTimers();
 
-        // Draw to the screen
-        window.clear();
-        // if the draw flag is set, update the screen
+        // if the draw flag is set, upload the new frame
 		if(myChip8.drawFlag){
-            drawGraphics(myChip8, window);
-            window.display();
+            unsigned char gfx_bfr[64*32];
+            myChip8.copyGfxBuffer(gfx_bfr);
+            display.update(gfx_bfr);
+            myChip8.drawFlag = false;
 		}
 
+        // Draw to the screen
+        window.clear();
+        display.draw(window);
+        window.display();
+
         // Store the key press state
-		captureInputs(window, myChip8, keys);
+		captureInputs(window, myChip8, display, keys);
     }
 }
 
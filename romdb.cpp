@@ -0,0 +1,121 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include "romdb.h"
+
+bool RomDatabase::load(const char* path){
+    std::ifstream file(path);
+    if(!file){
+        return false;
+    }
+
+    std::string line;
+    unsigned int lineNumber = 0;
+    while(std::getline(file, line)){
+        ++lineNumber;
+
+        size_t start = line.find_first_not_of(" \t\r");
+        if(start == std::string::npos || line[start] == '#'){
+            continue;
+        }
+
+        uint64_t hash;
+        RomProfile profile;
+        if(parseLine(line, hash, profile)){
+            profiles[hash] = profile;
+        }
+        else{
+            std::cout << path << ":" << lineNumber << ": invalid rom profile, skipped" << std::endl;
+        }
+    }
+    return true;
+}
+
+bool RomDatabase::loadWithFallback(const char* path, const char* executable){
+    if(load(path)){
+        return true;
+    }
+
+    std::string exePath = executable ? executable : "";
+    size_t slash = exePath.find_last_of('/');
+    if(path[0] != '/' && slash != std::string::npos){
+        std::string nextToExe = exePath.substr(0, slash + 1) + path;
+        if(load(nextToExe.c_str())){
+            return true;
+        }
+    }
+
+    std::cout << "Rom database " << path << " not found, using default settings for all games." << std::endl;
+    return false;
+}
+
+bool RomDatabase::parseLine(const std::string& line, uint64_t& hash, RomProfile& profile){
+    std::istringstream fields(line);
+    std::string hashField, platform, cycles, quirks, keys;
+    if(!(fields >> hashField >> platform >> cycles >> quirks >> keys)){
+        return false;
+    }
+
+    char* end;
+    hash = std::strtoull(hashField.c_str(), &end, 16);
+    if(*end != '\0'){ return false; }
+
+    if(platform == "chip8")       { profile.platform = platform_Chip8; }
+    else if(platform == "schip")  { profile.platform = platform_SChip; }
+    else if(platform == "xochip") { profile.platform = platform_XOChip; }
+    else { return false; }
+
+    profile.cyclesPerFrame = std::strtoul(cycles.c_str(), &end, 10);
+    if(*end != '\0'){ return false; }
+
+    if(quirks != "-"){
+        std::istringstream names(quirks);
+        std::string name;
+        while(std::getline(names, name, ',')){
+            if(name == "shift")          { profile.quirks.shiftUsesVY = true; }
+            else if(name == "loadstore") { profile.quirks.loadStoreIncrementsI = true; }
+            else if(name == "jump")      { profile.quirks.jumpUsesVX = true; }
+            else if(name == "vfreset")   { profile.quirks.logicResetsVF = true; }
+            else if(name == "clip")      { profile.quirks.clipSprites = true; }
+            else { return false; }
+        }
+    }
+
+    if(keys != "-"){
+        if(keys.size() != 16){ return false; }
+        for(char c: keys){
+            if(!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z'))){ return false; }
+        }
+        profile.keyMap = keys;
+    }
+
+    // The title is the rest of the line
+    std::getline(fields >> std::ws, profile.title);
+    return true;
+}
+
+const RomProfile* RomDatabase::find(uint64_t romHash) const{
+    auto it = profiles.find(romHash);
+    if(it == profiles.end()){
+        return nullptr;
+    }
+    return &it->second;
+}
+
+size_t RomDatabase::size() const{
+    return profiles.size();
+}
+
+const char* platformName(Platform platform){
+    switch(platform){
+        case platform_Chip8:  return "CHIP-8";
+        case platform_SChip:  return "SCHIP";
+        case platform_XOChip: return "XO-CHIP";
+    }
+    return "unknown";
+}
+
+//
+// EOF
+//
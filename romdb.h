@@ -0,0 +1,75 @@
+/*
+ * File: romdb.h
+ * Description: Database of per-game settings, indexed by Chip8::romHash.
+ *
+ * The database is a text file with one game per line:
+ *
+ *   # hash            platform  cycles  quirks          keys              title
+ *   <hash>            chip8     15      shift,vfreset   x123qweasdzc4rfv  Some Game
+ *
+ * hash     : Chip8::hashRom() of the game file, in hexadecimal
+ * platform : chip8, schip or xochip
+ * cycles   : instructions per 1/60 s frame
+ * quirks   : comma separated list of shift, loadstore, jump, vfreset, clip,
+ *            or - for none
+ * keys     : 16 characters (0-9, a-z), the keyboard key of chip8 keys 0 to F,
+ *            or - for the default layout
+ * title    : rest of the line, optional
+ *
+ * Empty lines and lines starting with # are ignored.
+ * */
+
+#ifndef ROMDB_H
+#define ROMDB_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "chip8.h"
+
+enum Platform {
+    platform_Chip8,
+    platform_SChip,
+    platform_XOChip
+};
+
+// Keyboard keys of the chip8 keys 0 to F, laid out on {1234, qwer, asdf, zxcv}
+constexpr const char* romdb_DefaultKeyMap = "x123qweasdzc4rfv";
+
+struct RomProfile {
+    Platform platform = platform_Chip8;
+    unsigned int cyclesPerFrame = 0;    // 0 = keep the default speed
+    Quirks quirks;
+    std::string keyMap = romdb_DefaultKeyMap;
+    std::string title;
+};
+
+class RomDatabase {
+public:
+    // Reads the database file. Returns false if it cannot be opened; lines
+    // that cannot be parsed are reported and skipped.
+    bool load(const char* path);
+
+    // Like load(), but a relative path that cannot be opened from the working
+    // directory is also looked up next to the executable. Reports on the
+    // console when the database cannot be found.
+    bool loadWithFallback(const char* path, const char* executable);
+
+    // Returns the profile of a game, or nullptr if it is not in the database.
+    const RomProfile* find(uint64_t romHash) const;
+
+    size_t size() const;
+
+private:
+    bool parseLine(const std::string& line, uint64_t& hash, RomProfile& profile);
+
+    std::unordered_map<uint64_t, RomProfile> profiles;
+};
+
+const char* platformName(Platform platform);
+
+#endif // ROMDB_H
+
+//
+// EOF
+//
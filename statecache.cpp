@@ -0,0 +1,85 @@
+#include "statecache.h"
+
+StateCache::StateCache(size_t l_initialCapacity, size_t l_maxEntries)
+    : count(0), maxEntries(l_maxEntries), hasZero(false)
+{
+    // Capacity must be a power of two for the index mask
+    initialCapacity = 16;
+    while(initialCapacity < l_initialCapacity){
+        initialCapacity <<= 1;
+    }
+    table.assign(initialCapacity, 0);
+}
+
+bool StateCache::insert(uint64_t hash){
+    if(hash == 0){
+        bool isNew = !hasZero;
+        hasZero = true;
+        return isNew;
+    }
+
+    if(maxEntries > 0 && count >= maxEntries && !contains(hash)){
+        clear();
+    }
+
+    // Keep the load factor under 1/2
+    if(2 * (count + 1) > table.size()){
+        grow();
+    }
+
+    size_t mask = table.size() - 1;
+    for(size_t i = hash & mask; ; i = (i + 1) & mask){
+        if(table[i] == hash){
+            return false;
+        }
+        if(table[i] == 0){
+            table[i] = hash;
+            ++count;
+            return true;
+        }
+    }
+}
+
+bool StateCache::contains(uint64_t hash) const{
+    if(hash == 0){
+        return hasZero;
+    }
+
+    size_t mask = table.size() - 1;
+    for(size_t i = hash & mask; table[i] != 0; i = (i + 1) & mask){
+        if(table[i] == hash){
+            return true;
+        }
+    }
+    return false;
+}
+
+void StateCache::clear(){
+    // Release what the table grew to, so a cleared cache is small again
+    std::vector<uint64_t>(initialCapacity, 0).swap(table);
+    count = 0;
+    hasZero = false;
+}
+
+size_t StateCache::size() const{
+    return count + (hasZero ? 1 : 0);
+}
+
+void StateCache::grow(){
+    std::vector<uint64_t> old(table.size() * 2, 0);
+    old.swap(table);
+
+    size_t mask = table.size() - 1;
+    for(auto h: old){
+        if(h == 0){ continue; }
+        size_t i = h & mask;
+        while(table[i] != 0){
+            i = (i + 1) & mask;
+        }
+        table[i] = h;
+    }
+}
+
+//
+// EOF
+//
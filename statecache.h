@@ -0,0 +1,47 @@
+/*
+ * File: statecache.h
+ * Description: Set of already visited machine states, keyed by Chip8::stateHash().
+ *
+ * Used by headless search and the environment server to prune states (and
+ * detect loops) without comparing whole machines.
+ * */
+
+#ifndef STATECACHE_H
+#define STATECACHE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+class StateCache {
+public:
+    // maxEntries bounds the memory used: when the cache is full, it is
+    // cleared before the next new state is recorded. 0 means no limit.
+    // The table grows as needed and shrinks back to initialCapacity when
+    // the cache is cleared.
+    explicit StateCache(size_t initialCapacity = 1024, size_t maxEntries = 0);
+
+    // Records a state. Returns true if it had not been visited before
+    // (or since the cache was last emptied).
+    bool insert(uint64_t hash);
+    bool contains(uint64_t hash) const;
+    void clear();
+    size_t size() const;
+
+private:
+    void grow();
+
+    // Open addressing with linear probing. 0 marks an empty slot, so the
+    // (unlikely) hash 0 is tracked separately.
+    std::vector<uint64_t> table;
+    size_t count;
+    size_t initialCapacity;
+    size_t maxEntries;
+    bool hasZero;
+};
+
+#endif // STATECACHE_H
+
+//
+// EOF
+//